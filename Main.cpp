@@ -7,6 +7,16 @@
 #include <ctime>
 #include <functional>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <set>
+#include <tuple>
+#include <limits>
 using namespace std;
 
 // Crop information structure
@@ -21,6 +31,20 @@ struct Crop {
     string originLocation;              // Where it was grown
     string areaCode;                    // Region code (North, South, East, West)
     
+    // Freshness score (0 if not recorded)
+    float freshness() const {
+        auto it = qualityMetrics.find("freshness");
+        return it != qualityMetrics.end() ? it->second : 0.0f;
+    }
+    
+    // Compare all fields (used to skip repeated copies when archiving)
+    bool operator==(const Crop& other) const {
+        return id == other.id && type == other.type && quantity == other.quantity &&
+               harvestDate == other.harvestDate && qualityMetrics == other.qualityMetrics &&
+               certifications == other.certifications && farmerId == other.farmerId &&
+               originLocation == other.originLocation && areaCode == other.areaCode;
+    }
+    
     // Display crop details
     void display() const {
         cout << "Crop ID: " << id << endl;
@@ -58,14 +82,142 @@ struct TransactionNode {
     TransactionNode* previous;
     TransactionNode* next;
     
+    // Lot transactions: one node shared by the chains of many crops
+    vector<TransactionNode*> lotMembers; // Previous transaction of each crop in the lot
+    
     // Constructor
     TransactionNode(string id, string handler, string type, 
                    string loc, string action, Crop crop) : 
         transactionId(id), handlerId(handler), handlerType(type),
         location(loc), actionTaken(action), cropDetails(crop),
         timestamp(time(nullptr)), previous(nullptr), next(nullptr) {}
+    
+    // Constructor for a lot transaction (no per-crop copy is stored)
+    TransactionNode(string id, string handler, string type, 
+                   string loc, string action, vector<TransactionNode*> members) : 
+        transactionId(id), timestamp(time(nullptr)), handlerId(handler), handlerType(type),
+        location(loc), actionTaken(action), cropDetails(),
+        previous(nullptr), next(nullptr), lotMembers(members) {}
+    
+    // Check if this node covers a lot of crops
+    bool isLot() const {
+        return !lotMembers.empty();
+    }
+};
+
+// Binary record helpers for on-disk storage
+template <typename T>
+void writeValue(ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+T readValue(istream& in) {
+    T value{};
+    in.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return value;
+}
+
+void writeString(ostream& out, const string& value) {
+    writeValue<uint32_t>(out, value.size());
+    out.write(value.data(), value.size());
+}
+
+// Longest string a record may hold; anything longer means the record is damaged
+const uint32_t maxStoredStringLength = 1 << 20;
+
+string readString(istream& in) {
+    uint32_t length = readValue<uint32_t>(in);
+    string value;
+    if (in && length > maxStoredStringLength) {
+        in.setstate(ios::failbit);
+    } else if (in) {
+        value.resize(length);
+        in.read(&value[0], length);
+    }
+    return value;
+}
+
+void writeCrop(ostream& out, const Crop& crop) {
+    writeString(out, crop.id);
+    writeString(out, crop.type);
+    writeValue<double>(out, crop.quantity);
+    writeValue<int64_t>(out, crop.harvestDate);
+    writeValue<uint32_t>(out, crop.qualityMetrics.size());
+    for (const auto& metric : crop.qualityMetrics) {
+        writeString(out, metric.first);
+        writeValue<float>(out, metric.second);
+    }
+    writeValue<uint32_t>(out, crop.certifications.size());
+    for (const auto& cert : crop.certifications) {
+        writeString(out, cert);
+    }
+    writeString(out, crop.farmerId);
+    writeString(out, crop.originLocation);
+    writeString(out, crop.areaCode);
+}
+
+Crop readCrop(istream& in) {
+    Crop crop;
+    crop.id = readString(in);
+    crop.type = readString(in);
+    crop.quantity = readValue<double>(in);
+    crop.harvestDate = readValue<int64_t>(in);
+    uint32_t metricCount = readValue<uint32_t>(in);
+    for (uint32_t i = 0; i < metricCount && in; i++) {
+        string name = readString(in);
+        crop.qualityMetrics[name] = readValue<float>(in);
+    }
+    uint32_t certCount = readValue<uint32_t>(in);
+    for (uint32_t i = 0; i < certCount && in; i++) {
+        crop.certifications.push_back(readString(in));
+    }
+    crop.farmerId = readString(in);
+    crop.originLocation = readString(in);
+    crop.areaCode = readString(in);
+    return crop;
+}
+
+// Write the fields of a transaction (links and crop are stored by the caller)
+void writeTransactionFields(ostream& out, const TransactionNode* node) {
+    writeString(out, node->transactionId);
+    writeValue<int64_t>(out, node->timestamp);
+    writeString(out, node->handlerId);
+    writeString(out, node->handlerType);
+    writeString(out, node->location);
+    writeString(out, node->actionTaken);
+    writeString(out, node->nextDestination);
+}
+
+TransactionNode* readTransactionFields(istream& in) {
+    string id = readString(in);
+    time_t timestamp = readValue<int64_t>(in);
+    string handler = readString(in);
+    string type = readString(in);
+    string loc = readString(in);
+    string action = readString(in);
+    
+    TransactionNode* node = new TransactionNode(id, handler, type, loc, action, Crop());
+    node->timestamp = timestamp;
+    node->nextDestination = readString(in);
+    return node;
+}
+
+// What ingest does when a leaf queue (and its overflow file) is full
+enum class OverflowPolicy {
+    Block,                              // Hold the crop until the queue drains
+    Reject,                             // Refuse the crop
+    Reroute                             // Send the crop to another leaf with room
+};
+
+// Outcome of adding a transaction to a leaf queue
+enum class EnqueueResult {
+    Accepted,                           // Kept in memory
+    Spilled,                            // Written to the overflow file
+    Full                                // No room anywhere
 };
 
+class RoutingDecisionTree;
 
 struct DecisionNode {
     string nodeId;
@@ -77,16 +229,81 @@ struct DecisionNode {
     DecisionNode* leftChild;            // True decision path
     DecisionNode* rightChild;           // False decision path
     
+    // Queue limits
+    int capacity;                       // Max transactions kept in memory (0 = unbounded)
+    int overflowCapacity;               // Max transactions in the overflow file (0 = no overflow tier)
+    OverflowPolicy overflowPolicy;      // Backpressure applied when both are full
+    
+    // Overflow tier: newest arrivals wait in a file and are reloaded in FIFO order
+    string overflowFile;
+    int spilledCount;
+    int64_t spillReadOffset;
+    int64_t spillWriteOffset;
+    function<void(TransactionNode*, const string&, int64_t)> onSpill; // Release a transaction written at an offset
+    function<void(TransactionNode*)> onReload;  // Take back a transaction read from the file
+    function<void(const string&)> onOverflowLost; // The overflow file could not be read back
+    
     // Constructor
     DecisionNode(string id, string criteria, string desc) : 
         nodeId(id), criteriaType(criteria), description(desc),
-        leftChild(nullptr), rightChild(nullptr) {}
+        leftChild(nullptr), rightChild(nullptr),
+        capacity(0), overflowCapacity(0), overflowPolicy(OverflowPolicy::Block),
+        spilledCount(0), spillReadOffset(0), spillWriteOffset(0) {}
+    
+    // Check if another transaction can be accepted
+    bool hasRoom() {
+        return capacity == 0 || (int)processingQueue.size() < capacity ||
+               spilledCount < overflowCapacity;
+    }
     
     // Enqueue a transaction to this node's queue
-    void enqueue(TransactionNode* transaction) {
-        processingQueue.push(transaction);
+    EnqueueResult enqueue(TransactionNode* transaction) {
+        // Anything already spilled is older, so new arrivals queue behind it
+        if (capacity == 0 || ((int)processingQueue.size() < capacity && spilledCount == 0)) {
+            processingQueue.push(transaction);
+            return EnqueueResult::Accepted;
+        }
+        
+        if (spilledCount >= overflowCapacity) {
+            return EnqueueResult::Full;
+        }
+        
+        ostringstream record;
+        writeTransactionFields(record, transaction);
+        writeCrop(record, transaction->cropDetails);
+        
+        ofstream out(overflowFile, ios::binary | ios::app);
+        out << record.str();
+        out.close();
+        
+        // Keep the transaction in memory rather than lose it
+        if (!out) {
+            cout << "Warning: could not write overflow file " << overflowFile << endl;
+            processingQueue.push(transaction);
+            return EnqueueResult::Accepted;
+        }
+        
+        if (onSpill) onSpill(transaction, overflowFile, spillWriteOffset);
+        delete transaction;
+        spillWriteOffset += record.str().size();
+        spilledCount++;
+        return EnqueueResult::Spilled;
     }
     
+    // Check if queue is empty
+    bool isQueueEmpty() {
+        return queueSize() == 0;
+    }
+    
+    // Get queue size, including transactions in the overflow file
+    int queueSize() {
+        return processingQueue.size() + spilledCount;
+    }
+    
+private:
+    // Dequeues go through RoutingDecisionTree so its supply totals stay current
+    friend class RoutingDecisionTree;
+    
     // Get next transaction from queue
     TransactionNode* dequeue() {
         if (processingQueue.empty()) {
@@ -95,17 +312,248 @@ struct DecisionNode {
         
         TransactionNode* transaction = processingQueue.front();
         processingQueue.pop();
+        
+        // Refill memory from the overflow file as the queue drains
+        if (spilledCount > 0) {
+            reloadSpilled();
+        }
         return transaction;
     }
     
-    // Check if queue is empty
-    bool isQueueEmpty() {
-        return processingQueue.empty();
+    // Read the oldest spilled transaction back into memory
+    void reloadSpilled() {
+        ifstream in(overflowFile, ios::binary);
+        in.seekg(spillReadOffset);
+        TransactionNode* transaction = readTransactionFields(in);
+        transaction->cropDetails = readCrop(in);
+        
+        if (!in) {
+            cout << "Warning: lost " << spilledCount << " transaction(s) in overflow file " << overflowFile << endl;
+            delete transaction;
+            spilledCount = 0;
+            if (onOverflowLost) onOverflowLost(overflowFile);
+        } else {
+            spillReadOffset = in.tellg();
+            spilledCount--;
+            if (onReload) onReload(transaction);
+            processingQueue.push(transaction);
+        }
+        
+        // Start the file over once it has been fully read back
+        if (spilledCount == 0) {
+            remove(overflowFile.c_str());
+            spillReadOffset = 0;
+            spillWriteOffset = 0;
+        }
     }
+};
+
+// Column store of the in-memory chain for ad-hoc group-by scans
+class SupplyScanEngine {
+public:
+    // Columns a scan can group by
+    enum class Column {
+        Region,
+        CropType,
+        HandlerType
+    };
     
-    // Get queue size
-    int queueSize() {
-        return processingQueue.size();
+    // Totals for one group of a scan
+    struct GroupResult {
+        string key;
+        int count;
+        double quantity;
+        double freshnessSum;
+        float freshnessMin;
+        float freshnessMax;
+    };
+    
+private:
+    // Dictionary encoding for string columns
+    struct Dictionary {
+        unordered_map<string, int32_t> codes;
+        vector<string> values;
+        
+        int32_t encode(const string& value) {
+            auto it = codes.find(value);
+            if (it != codes.end()) return it->second;
+            codes[value] = values.size();
+            values.push_back(value);
+            return values.size() - 1;
+        }
+        
+        // Code of a value, -1 if it never occurred
+        int32_t find(const string& value) const {
+            auto it = codes.find(value);
+            return it != codes.end() ? it->second : -1;
+        }
+    };
+    
+    Dictionary regions, cropTypes, handlerTypes;
+    
+    // One row per crop, describing its latest in-memory hop
+    vector<int32_t> regionColumn;
+    vector<int32_t> cropTypeColumn;
+    vector<int32_t> handlerTypeColumn;
+    vector<double> quantityColumn;
+    vector<float> freshnessColumn;
+    vector<uint8_t> liveColumn;         // 0 once the crop's latest hop leaves memory
+    vector<string> rowCrop;             // Crop ID of each row
+    vector<string> rowTransaction;      // Transaction ID of each row's hop
+    
+    unordered_map<string, int> rowByCrop;
+    unordered_map<string, vector<int>> rowsByTransaction;
+    int deadRows;
+    
+    void writeRow(int row, const string& transactionId, const Crop& crop, const string& handlerType) {
+        regionColumn[row] = regions.encode(crop.areaCode);
+        cropTypeColumn[row] = cropTypes.encode(crop.type);
+        handlerTypeColumn[row] = handlerTypes.encode(handlerType);
+        quantityColumn[row] = crop.quantity;
+        freshnessColumn[row] = crop.freshness();
+        rowTransaction[row] = transactionId;
+        rowsByTransaction[transactionId].push_back(row);
+    }
+    
+    // Point a crop's row at a newer hop, adding the row on the crop's first hop
+    void upsertRow(const string& transactionId, const Crop& crop, const string& handlerType) {
+        auto existing = rowByCrop.find(crop.id);
+        if (existing != rowByCrop.end()) {
+            int row = existing->second;
+            
+            // Hand the row over from its previous hop
+            auto previous = rowsByTransaction.find(rowTransaction[row]);
+            if (previous != rowsByTransaction.end()) {
+                vector<int>& rows = previous->second;
+                rows.erase(remove(rows.begin(), rows.end(), row), rows.end());
+                if (rows.empty()) rowsByTransaction.erase(previous);
+            }
+            writeRow(row, transactionId, crop, handlerType);
+            return;
+        }
+        
+        int row = liveColumn.size();
+        regionColumn.push_back(0);
+        cropTypeColumn.push_back(0);
+        handlerTypeColumn.push_back(0);
+        quantityColumn.push_back(0);
+        freshnessColumn.push_back(0);
+        liveColumn.push_back(1);
+        rowCrop.push_back(crop.id);
+        rowTransaction.push_back("");
+        rowByCrop[crop.id] = row;
+        writeRow(row, transactionId, crop, handlerType);
+    }
+    
+    // Rewrite the columns without dropped rows
+    void compact() {
+        SupplyScanEngine compacted;
+        compacted.regions = regions;
+        compacted.cropTypes = cropTypes;
+        compacted.handlerTypes = handlerTypes;
+        
+        for (size_t row = 0; row < liveColumn.size(); row++) {
+            if (!liveColumn[row]) continue;
+            
+            int newRow = compacted.liveColumn.size();
+            compacted.regionColumn.push_back(regionColumn[row]);
+            compacted.cropTypeColumn.push_back(cropTypeColumn[row]);
+            compacted.handlerTypeColumn.push_back(handlerTypeColumn[row]);
+            compacted.quantityColumn.push_back(quantityColumn[row]);
+            compacted.freshnessColumn.push_back(freshnessColumn[row]);
+            compacted.liveColumn.push_back(1);
+            compacted.rowCrop.push_back(rowCrop[row]);
+            compacted.rowTransaction.push_back(rowTransaction[row]);
+            compacted.rowByCrop[rowCrop[row]] = newRow;
+            compacted.rowsByTransaction[rowTransaction[row]].push_back(newRow);
+        }
+        *this = move(compacted);
+    }
+    
+    // Clear the selection of rows whose column does not hold the given value
+    static void applyFilter(vector<uint8_t>& selected, const vector<int32_t>& column,
+                            const Dictionary& dictionary, const string& value) {
+        if (value.empty()) return;
+        
+        int32_t code = dictionary.find(value);
+        for (size_t i = 0; i < selected.size(); i++) {
+            selected[i] &= (column[i] == code);
+        }
+    }
+    
+public:
+    // Constructor
+    SupplyScanEngine() : deadRows(0) {}
+    
+    // Record a transaction now held in memory as the latest hop of its crops
+    void append(const TransactionNode* node) {
+        if (node->isLot()) {
+            for (auto* member : node->lotMembers) {
+                upsertRow(node->transactionId, member->cropDetails, node->handlerType);
+            }
+        } else {
+            upsertRow(node->transactionId, node->cropDetails, node->handlerType);
+        }
+    }
+    
+    // Drop the crops whose latest hop left memory
+    void drop(const string& transactionId) {
+        auto it = rowsByTransaction.find(transactionId);
+        if (it == rowsByTransaction.end()) return;
+        
+        for (int row : it->second) {
+            liveColumn[row] = 0;
+            rowByCrop.erase(rowCrop[row]);
+        }
+        deadRows += it->second.size();
+        rowsByTransaction.erase(it);
+        
+        if (deadRows * 2 > (int)liveColumn.size()) {
+            compact();
+        }
+    }
+    
+    // Group in-memory crops by one column; empty filter values match everything
+    vector<GroupResult> groupBy(Column column, const string& region = "", const string& cropType = "",
+                                const string& handlerType = "") const {
+        const vector<int32_t>& keys = (column == Column::Region) ? regionColumn :
+                                      (column == Column::CropType) ? cropTypeColumn : handlerTypeColumn;
+        const Dictionary& dictionary = (column == Column::Region) ? regions :
+                                       (column == Column::CropType) ? cropTypes : handlerTypes;
+        
+        // Build the row selection one column at a time
+        vector<uint8_t> selected(liveColumn);
+        applyFilter(selected, regionColumn, regions, region);
+        applyFilter(selected, cropTypeColumn, cropTypes, cropType);
+        applyFilter(selected, handlerTypeColumn, handlerTypes, handlerType);
+        
+        // Aggregate into dense arrays indexed by dictionary code
+        size_t groups = dictionary.values.size();
+        vector<int> counts(groups, 0);
+        vector<double> quantities(groups, 0.0);
+        vector<double> freshnessSums(groups, 0.0);
+        vector<float> freshnessMins(groups, numeric_limits<float>::max());
+        vector<float> freshnessMaxs(groups, numeric_limits<float>::lowest());
+        
+        for (size_t i = 0; i < selected.size(); i++) {
+            if (!selected[i]) continue;
+            
+            int32_t key = keys[i];
+            counts[key]++;
+            quantities[key] += quantityColumn[i];
+            freshnessSums[key] += freshnessColumn[i];
+            freshnessMins[key] = min(freshnessMins[key], freshnessColumn[i]);
+            freshnessMaxs[key] = max(freshnessMaxs[key], freshnessColumn[i]);
+        }
+        
+        vector<GroupResult> result;
+        for (size_t key = 0; key < groups; key++) {
+            if (counts[key] > 0) {
+                result.push_back({dictionary.values[key], counts[key], quantities[key],
+                                  freshnessSums[key], freshnessMins[key], freshnessMaxs[key]});
+            }
+        }
+        return result;
     }
 };
 
@@ -114,8 +562,263 @@ class TraceabilityChain {
 private:
     unordered_map<string, TransactionNode*> transactionMap; // For quick lookup
     vector<TransactionNode*> allTransactions; // Store all transactions for listing
+    unordered_map<TransactionNode*, size_t> transactionPositions; // Index into allTransactions
+    
+    // Queued transactions spilled to overflow files, kept traceable by crop ID
+    struct SpilledStub {
+        string transactionId;
+        string overflowFile;
+        int64_t offset;
+    };
+    unordered_map<string, SpilledStub> spilledStubs;
+    SupplyScanEngine scanEngine;        // Column copy of the in-memory transactions
+    
+    // Cold tier: completed chains compacted into on-disk segments
+    struct ArchiveLocation {
+        int32_t segment;                // Segment number; the file name comes from segmentName()
+        int64_t offset;
+    };
+    unordered_map<string, ArchiveLocation> archiveIndex; // Crop ID -> archived chain record
+    unordered_map<string, vector<TransactionNode*>> faultedChains; // Chains read back from disk
+    double archiveAfterSeconds;         // Age of a completed chain before it is archived
+    double archiveIntervalSeconds;      // Minimum time between archive passes
+    time_t lastArchivePass;
+    size_t maxFaultedChains;            // Faulted chains kept in memory at once
+    int64_t maxSegmentSize;             // Passes append to the open segment until it reaches this size
+    string segmentPrefix;
+    string indexFile;                   // Persisted crop ID -> segment record entries
+    int segmentCounter;                 // Number of the open (latest) segment
+    int highestArchivedId;              // Highest numeric suffix of any archived crop or transaction ID
+    
+    // Index file record types
+    enum IndexRecord : uint8_t {
+        indexCropEntry = 1,             // Crop ID -> segment record
+        indexHighestId = 2              // ID high-water mark after an archive pass
+    };
+    
+    static string segmentName(const string& prefix, int number) {
+        return prefix + to_string(number) + ".dat";
+    }
+    
+    // Numeric suffix of an ID such as "CROP1001" (0 if none)
+    static int idNumber(const string& id) {
+        size_t digits = id.find_first_of("0123456789");
+        return digits == string::npos ? 0 : atoi(id.c_str() + digits);
+    }
+    
+    // Pick up segments and index entries written by earlier runs
+    void loadArchive() {
+        while (ifstream(segmentName(segmentPrefix, segmentCounter + 1), ios::binary)) {
+            segmentCounter++;
+        }
+        
+        // Later entries replace earlier ones for the same crop
+        ifstream in(indexFile, ios::binary);
+        while (in) {
+            uint8_t recordType = readValue<uint8_t>(in);
+            if (!in) break;
+            
+            if (recordType == indexCropEntry) {
+                string cropId = readString(in);
+                int32_t segment = readValue<int32_t>(in);
+                int64_t offset = readValue<int64_t>(in);
+                if (in) {
+                    archiveIndex[cropId] = {segment, offset};
+                }
+            } else if (recordType == indexHighestId) {
+                int32_t highest = readValue<int32_t>(in);
+                if (in) {
+                    highestArchivedId = max(highestArchivedId, (int)highest);
+                }
+            } else {
+                cout << "Warning: unknown record in history index " << indexFile << endl;
+                break;
+            }
+        }
+    }
+    
+    // Collect every node of a chain, predecessors before successors
+    void collectChain(TransactionNode* node, unordered_set<TransactionNode*>& seen,
+                      vector<TransactionNode*>& chain) {
+        if (node == nullptr || seen.count(node)) return;
+        seen.insert(node);
+        
+        collectChain(node->previous, seen, chain);
+        for (auto* member : node->lotMembers) {
+            collectChain(member, seen, chain);
+        }
+        chain.push_back(node);
+    }
+    
+    // Write a chain as one segment record; links are stored as positions in the record
+    void writeChainRecord(ostream& out, const vector<TransactionNode*>& chain) {
+        unordered_map<TransactionNode*, int32_t> position;
+        for (int i = 0; i < (int)chain.size(); i++) {
+            position[chain[i]] = i;
+        }
+        auto positionOf = [&](TransactionNode* node) {
+            auto it = position.find(node);
+            return it == position.end() ? -1 : it->second;
+        };
+        
+        writeValue<uint32_t>(out, chain.size());
+        for (auto* node : chain) {
+            writeTransactionFields(out, node);
+            writeValue<int32_t>(out, positionOf(node->previous));
+            writeValue<int32_t>(out, positionOf(node->next));
+            writeValue<uint32_t>(out, node->lotMembers.size());
+            for (auto* member : node->lotMembers) {
+                writeValue<int32_t>(out, positionOf(member));
+            }
+            
+            // Crop copies repeat along a chain, so only store them when they change
+            if (node->isLot()) {
+                writeValue<uint8_t>(out, 0);
+            } else if (node->previous != nullptr && node->previous->cropDetails == node->cropDetails) {
+                writeValue<uint8_t>(out, 1);
+            } else {
+                writeValue<uint8_t>(out, 2);
+                writeCrop(out, node->cropDetails);
+            }
+        }
+    }
+    
+    // Read a chain record written by writeChainRecord; empty on a damaged record
+    vector<TransactionNode*> readChainRecord(istream& in) {
+        vector<TransactionNode*> chain;
+        vector<int32_t> nextPosition;
+        
+        uint32_t count = readValue<uint32_t>(in);
+        for (uint32_t i = 0; i < count && in; i++) {
+            TransactionNode* node = readTransactionFields(in);
+            chain.push_back(node);
+            
+            int32_t previousPosition = readValue<int32_t>(in);
+            nextPosition.push_back(readValue<int32_t>(in));
+            if (previousPosition >= 0 && previousPosition < (int32_t)i) {
+                node->previous = chain[previousPosition];
+            }
+            
+            uint32_t memberCount = readValue<uint32_t>(in);
+            for (uint32_t m = 0; m < memberCount && in; m++) {
+                int32_t memberPosition = readValue<int32_t>(in);
+                if (memberPosition >= 0 && memberPosition < (int32_t)i) {
+                    node->lotMembers.push_back(chain[memberPosition]);
+                }
+            }
+            
+            uint8_t cropMode = readValue<uint8_t>(in);
+            if (cropMode == 1 && node->previous != nullptr) {
+                node->cropDetails = node->previous->cropDetails;
+            } else if (cropMode == 2) {
+                node->cropDetails = readCrop(in);
+            }
+        }
+        
+        if (!in || chain.size() != count) {
+            for (auto* node : chain) delete node;
+            return {};
+        }
+        
+        for (int i = 0; i < (int)chain.size(); i++) {
+            if (nextPosition[i] >= 0 && nextPosition[i] < (int)chain.size()) {
+                chain[i]->next = chain[nextPosition[i]];
+            }
+        }
+        return chain;
+    }
+    
+    // Free one faulted chain if it is cached
+    void releaseFaultedChain(const string& key) {
+        auto it = faultedChains.find(key);
+        if (it == faultedChains.end()) return;
+        
+        for (auto* node : it->second) delete node;
+        faultedChains.erase(it);
+    }
+    
+    // Load a spilled queued transaction from its overflow file
+    TransactionNode* loadSpilledCrop(const string& cropId) {
+        auto stub = spilledStubs.find(cropId);
+        if (stub == spilledStubs.end()) {
+            return nullptr;
+        }
+        
+        string key = stub->second.overflowFile + "#" + to_string(stub->second.offset);
+        auto cached = faultedChains.find(key);
+        if (cached == faultedChains.end()) {
+            ifstream in(stub->second.overflowFile, ios::binary);
+            in.seekg(stub->second.offset);
+            TransactionNode* node = readTransactionFields(in);
+            node->cropDetails = readCrop(in);
+            
+            if (!in || node->transactionId != stub->second.transactionId) {
+                cout << "Warning: could not read queued transaction for " << cropId << endl;
+                delete node;
+                return nullptr;
+            }
+            
+            if (faultedChains.size() >= maxFaultedChains) {
+                releaseFaultedChains();
+            }
+            cached = faultedChains.emplace(key, vector<TransactionNode*>{node}).first;
+        }
+        return cached->second.front();
+    }
+    
+    // Free every chain faulted in from disk
+    void releaseFaultedChains() {
+        for (auto& pair : faultedChains) {
+            for (auto* node : pair.second) delete node;
+        }
+        faultedChains.clear();
+    }
+    
+    // Load the archived chain holding a crop; returns one of its transactions
+    TransactionNode* loadArchivedCrop(const string& cropId) {
+        auto location = archiveIndex.find(cropId);
+        if (location == archiveIndex.end()) {
+            return nullptr;
+        }
+        
+        string segmentFile = segmentName(segmentPrefix, location->second.segment);
+        string key = segmentFile + "#" + to_string(location->second.offset);
+        auto cached = faultedChains.find(key);
+        if (cached == faultedChains.end()) {
+            ifstream in(segmentFile, ios::binary);
+            in.seekg(location->second.offset);
+            vector<TransactionNode*> chain = readChainRecord(in);
+            if (chain.empty()) {
+                cout << "Warning: could not read archived history for " << cropId << endl;
+                return nullptr;
+            }
+            
+            if (faultedChains.size() >= maxFaultedChains) {
+                releaseFaultedChains();
+            }
+            cached = faultedChains.emplace(key, chain).first;
+        }
+        
+        for (auto* node : cached->second) {
+            if (!node->isLot() && node->cropDetails.id == cropId) {
+                return node;
+            }
+        }
+        return nullptr;
+    }
     
 public:
+    // Constructor
+    TraceabilityChain(double archiveAfter = 30 * 24 * 60 * 60, double archiveInterval = 60 * 60,
+                      size_t maxFaulted = 64, int64_t maxSegment = 4 * 1024 * 1024,
+                      string prefix = "history_segment_") :
+        archiveAfterSeconds(archiveAfter), archiveIntervalSeconds(archiveInterval),
+        lastArchivePass(0), maxFaultedChains(maxFaulted), maxSegmentSize(maxSegment),
+        segmentPrefix(prefix), indexFile(prefix + "index.dat"),
+        segmentCounter(0), highestArchivedId(0) {
+        loadArchive();
+    }
+    
     // Add new transaction to the chain
     void addTransaction(TransactionNode* node, TransactionNode* previous = nullptr) {
         if (previous != nullptr) {
@@ -123,7 +826,64 @@ public:
             node->previous = previous;
         }
         transactionMap[node->transactionId] = node;
+        transactionPositions[node] = allTransactions.size();
         allTransactions.push_back(node);
+        scanEngine.append(node);
+    }
+    
+    // Remove a transaction from memory without freeing it
+    void detachTransaction(TransactionNode* node) {
+        auto position = transactionPositions.find(node);
+        if (position == transactionPositions.end()) return;
+        
+        // Move the last transaction into the freed slot
+        TransactionNode* last = allTransactions.back();
+        allTransactions[position->second] = last;
+        transactionPositions[last] = position->second;
+        allTransactions.pop_back();
+        transactionPositions.erase(node);
+        
+        transactionMap.erase(node->transactionId);
+        scanEngine.drop(node->transactionId);
+    }
+    
+    // A queued transaction was written to an overflow file; keep a stub so the crop stays traceable
+    void spillTransaction(TransactionNode* node, const string& overflowFile, int64_t offset) {
+        spilledStubs[node->cropDetails.id] = {node->transactionId, overflowFile, offset};
+        detachTransaction(node);
+    }
+    
+    // A spilled transaction was read back from its overflow file
+    void restoreSpilled(TransactionNode* node) {
+        auto stub = spilledStubs.find(node->cropDetails.id);
+        if (stub != spilledStubs.end()) {
+            releaseFaultedChain(stub->second.overflowFile + "#" + to_string(stub->second.offset));
+            spilledStubs.erase(stub);
+        }
+        addTransaction(node);
+    }
+    
+    // An overflow file could not be read back; its stubs point at nothing now
+    void dropSpilled(const string& overflowFile) {
+        for (auto it = spilledStubs.begin(); it != spilledStubs.end();) {
+            if (it->second.overflowFile == overflowFile) {
+                releaseFaultedChain(it->second.overflowFile + "#" + to_string(it->second.offset));
+                it = spilledStubs.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    
+    // Add a lot transaction, pointing every member crop's chain at the shared node
+    void addLotTransaction(TransactionNode* lot) {
+        for (auto* member : lot->lotMembers) {
+            member->next = lot;
+        }
+        transactionMap[lot->transactionId] = lot;
+        transactionPositions[lot] = allTransactions.size();
+        allTransactions.push_back(lot);
+        scanEngine.append(lot);
     }
     
     // Get complete history of a crop
@@ -140,6 +900,16 @@ public:
             }
         }
         
+        // Not in memory: the crop may be waiting in an overflow file
+        if (current == nullptr) {
+            current = loadSpilledCrop(cropId);
+        }
+        
+        // Or its chain was archived: fault it back in from its segment
+        if (current == nullptr) {
+            current = loadArchivedCrop(cropId);
+        }
+        
         // If found, trace back to origin
         if (current != nullptr) {
             // Go to origin first
@@ -157,17 +927,147 @@ public:
         return history;
     }
     
+    // Highest numeric ID suffix among archived crops and transactions (including lots)
+    int highestArchivedIdNumber() {
+        return highestArchivedId;
+    }
+    
+    // Move completed chains older than the archive age into a new on-disk segment
+    int archiveCompletedChains() {
+        time_t now = time(nullptr);
+        if (lastArchivePass != 0 && difftime(now, lastArchivePass) < archiveIntervalSeconds) {
+            return 0;
+        }
+        lastArchivePass = now;
+        
+        unordered_set<TransactionNode*> archived;
+        vector<vector<TransactionNode*>> chains;
+        
+        // A chain is complete once its tail has left the farmer's queue
+        for (auto* node : allTransactions) {
+            bool completed = node->next == nullptr && (node->previous != nullptr || node->isLot());
+            if (completed && difftime(now, node->timestamp) >= archiveAfterSeconds) {
+                vector<TransactionNode*> chain;
+                collectChain(node, archived, chain);
+                chains.push_back(chain);
+            }
+        }
+        
+        if (chains.empty()) {
+            return 0;
+        }
+        
+        // Append to the open segment, starting a new one once it is full.
+        // Offsets come from the file's real end, which also covers torn earlier writes.
+        if (segmentCounter == 0) {
+            segmentCounter++;
+        }
+        string segmentFile = segmentName(segmentPrefix, segmentCounter);
+        ofstream out(segmentFile, ios::binary | ios::app);
+        out.seekp(0, ios::end);
+        int64_t baseOffset = out.tellp();
+        
+        if (out && baseOffset >= maxSegmentSize) {
+            out.close();
+            segmentFile = segmentName(segmentPrefix, ++segmentCounter);
+            out.open(segmentFile, ios::binary | ios::app);
+            out.seekp(0, ios::end);
+            baseOffset = out.tellp();
+        }
+        
+        ostringstream records;
+        vector<int64_t> offsets;
+        for (const auto& chain : chains) {
+            offsets.push_back(baseOffset + (int64_t)records.tellp());
+            writeChainRecord(records, chain);
+        }
+        
+        out << records.str();
+        out.close();
+        
+        // Keep everything in memory if the segment could not be written
+        if (!out || baseOffset < 0) {
+            cout << "Warning: could not write history segment " << segmentFile << endl;
+            return 0;
+        }
+        
+        ofstream index(indexFile, ios::binary | ios::app);
+        for (int i = 0; i < (int)chains.size(); i++) {
+            for (auto* node : chains[i]) {
+                highestArchivedId = max(highestArchivedId, idNumber(node->transactionId));
+                if (!node->isLot()) {
+                    highestArchivedId = max(highestArchivedId, idNumber(node->cropDetails.id));
+                    archiveIndex[node->cropDetails.id] = {segmentCounter, offsets[i]};
+                    writeValue<uint8_t>(index, indexCropEntry);
+                    writeString(index, node->cropDetails.id);
+                    writeValue<int32_t>(index, segmentCounter);
+                    writeValue<int64_t>(index, offsets[i]);
+                }
+            }
+        }
+        writeValue<uint8_t>(index, indexHighestId);
+        writeValue<int32_t>(index, highestArchivedId);
+        index.close();
+        if (!index) {
+            cout << "Warning: could not update history index " << indexFile << endl;
+        }
+        
+        // Evict the archived nodes from memory
+        allTransactions.erase(
+            remove_if(allTransactions.begin(), allTransactions.end(),
+                      [&](TransactionNode* node) { return archived.count(node) > 0; }),
+            allTransactions.end());
+        transactionPositions.clear();
+        for (size_t i = 0; i < allTransactions.size(); i++) {
+            transactionPositions[allTransactions[i]] = i;
+        }
+        for (auto* node : archived) {
+            transactionMap.erase(node->transactionId);
+            scanEngine.drop(node->transactionId);
+            delete node;
+        }
+        
+        return archived.size();
+    }
+    
+    // Group the in-memory chain by a column, optionally filtered
+    vector<SupplyScanEngine::GroupResult> groupBy(SupplyScanEngine::Column column, const string& region = "",
+                                                  const string& cropType = "", const string& handlerType = "") {
+        return scanEngine.groupBy(column, region, cropType, handlerType);
+    }
+    
+    // Check if a transaction comes after another one (same-second hops are ordered by the chain)
+    static bool isLaterHop(TransactionNode* earlier, TransactionNode* later) {
+        if (later->timestamp != earlier->timestamp) {
+            return later->timestamp > earlier->timestamp;
+        }
+        for (TransactionNode* node = earlier->next; node != nullptr; node = node->next) {
+            if (node == later) return true;
+        }
+        return false;
+    }
+    
     // List all available crops with their IDs
     void listAllCrops() {
         unordered_map<string, TransactionNode*> latestCropTransactions;
+        unordered_map<string, const Crop*> cropDetails;
         
         // Find the latest transaction for each crop
+        auto recordLatest = [&](const Crop& crop, TransactionNode* transaction) {
+            auto latest = latestCropTransactions.find(crop.id);
+            if (latest == latestCropTransactions.end() || isLaterHop(latest->second, transaction)) {
+                latestCropTransactions[crop.id] = transaction;
+                cropDetails[crop.id] = &crop;
+            }
+        };
         for (auto* transaction : allTransactions) {
-            string cropId = transaction->cropDetails.id;
-            
-            if (latestCropTransactions.find(cropId) == latestCropTransactions.end() ||
-                transaction->timestamp > latestCropTransactions[cropId]->timestamp) {
-                latestCropTransactions[cropId] = transaction;
+            if (transaction->isLot()) {
+                // A lot carries no crop copy; take details from each member
+                for (auto* member : transaction->lotMembers) {
+                    recordLatest(member->cropDetails, transaction);
+                }
+            } else {
+                recordLatest(transaction->cropDetails, transaction);
             }
         }
         
@@ -182,7 +1082,7 @@ public:
         cout << string(70, '-') << endl;
         
         for (const auto& pair : latestCropTransactions) {
-            Crop crop = pair.second->cropDetails;
+            const Crop& crop = *cropDetails[pair.first];
             cout << left << setw(10) << crop.id 
                  << setw(12) << crop.type 
                  << setw(12) << crop.quantity 
@@ -190,9 +1090,111 @@ public:
                  << setw(15) << pair.second->handlerType 
                  << setw(20) << pair.second->actionTaken.substr(0, 19) << endl;
         }
+        
+        // Crops waiting in overflow files: read their details back, opening each file once
+        unordered_map<string, ifstream> overflowFiles;
+        for (const auto& pair : spilledStubs) {
+            const SpilledStub& stub = pair.second;
+            auto file = overflowFiles.find(stub.overflowFile);
+            if (file == overflowFiles.end()) {
+                file = overflowFiles.emplace(stub.overflowFile, ifstream(stub.overflowFile, ios::binary)).first;
+            }
+            
+            ifstream& in = file->second;
+            in.clear();
+            in.seekg(stub.offset);
+            TransactionNode* queued = readTransactionFields(in);
+            queued->cropDetails = readCrop(in);
+            
+            if (in && queued->transactionId == stub.transactionId) {
+                const Crop& crop = queued->cropDetails;
+                cout << left << setw(10) << crop.id 
+                     << setw(12) << crop.type 
+                     << setw(12) << crop.quantity 
+                     << setw(10) << crop.areaCode 
+                     << setw(15) << queued->handlerType 
+                     << setw(20) << "Queued (overflow)" << endl;
+            } else {
+                cout << left << setw(10) << pair.first 
+                     << setw(12) << "-" 
+                     << setw(12) << "-" 
+                     << setw(10) << "-" 
+                     << setw(15) << "Farmer" 
+                     << setw(20) << "Queued (unreadable)" << endl;
+            }
+            delete queued;
+        }
+        
+        if (!archiveIndex.empty()) {
+            cout << archiveIndex.size() << " archived crop(s) not listed; trace them by ID to load their history." << endl;
+        }
     }
 };
 
+// Totals over a set of queued crops
+struct SupplySummary {
+    int count;
+    double quantity;                    // kg
+    double freshnessSum;
+    float freshnessMin;
+    float freshnessMax;
+    double demandWeightedQuantity;      // Sum of kg x regional demand (0-10)
+    
+    // Constructor
+    SupplySummary() : 
+        count(0), quantity(0), freshnessSum(0),
+        freshnessMin(0), freshnessMax(0), demandWeightedQuantity(0) {}
+    
+    // Mean freshness (0 when empty)
+    double meanFreshness() const {
+        return count > 0 ? freshnessSum / count : 0.0;
+    }
+};
+
+// Running totals for crops waiting in one region x crop type x leaf cell
+struct SupplyAggregate {
+    int count;
+    double quantity;
+    double freshnessSum;
+    multiset<float> freshnessValues;    // Ordered so min/max survive removals
+    double demandWeightedQuantity;
+    
+    // Constructor
+    SupplyAggregate() : count(0), quantity(0), freshnessSum(0), demandWeightedQuantity(0) {}
+    
+    void add(const Crop& crop, float demand) {
+        count++;
+        quantity += crop.quantity;
+        freshnessSum += crop.freshness();
+        freshnessValues.insert(crop.freshness());
+        demandWeightedQuantity += crop.quantity * demand;
+    }
+    
+    void remove(const Crop& crop, float demand) {
+        auto it = freshnessValues.find(crop.freshness());
+        if (it == freshnessValues.end()) return;
+        
+        count--;
+        quantity -= crop.quantity;
+        freshnessSum -= crop.freshness();
+        freshnessValues.erase(it);
+        demandWeightedQuantity -= crop.quantity * demand;
+    }
+    
+    // Fold this cell into a summary
+    void mergeInto(SupplySummary& summary) const {
+        if (count == 0) return;
+        
+        float cellMin = *freshnessValues.begin();
+        float cellMax = *freshnessValues.rbegin();
+        summary.freshnessMin = (summary.count == 0) ? cellMin : min(summary.freshnessMin, cellMin);
+        summary.freshnessMax = (summary.count == 0) ? cellMax : max(summary.freshnessMax, cellMax);
+        summary.count += count;
+        summary.quantity += quantity;
+        summary.freshnessSum += freshnessSum;
+        summary.demandWeightedQuantity += demandWeightedQuantity;
+    }
+};
 
 class RoutingDecisionTree {
 private:
@@ -202,8 +1204,77 @@ private:
     // Market demand data by region
     unordered_map<string, unordered_map<string, float>> regionalDemand;
     
+    // Crops held back by full leaf queues, oldest first
+    queue<pair<DecisionNode*, TransactionNode*>> blockedIngest;
+    int blockedIngestCapacity;          // Held crops beyond this are rejected
+    
+    // Queued supply keyed by region x crop type x leaf, kept current on enqueue and dequeue
+    map<tuple<string, string, string>, SupplyAggregate> queuedSupply;
+    
+    void recordQueued(DecisionNode* leaf, const Crop& crop) {
+        queuedSupply[make_tuple(crop.areaCode, crop.type, leaf->nodeId)]
+            .add(crop, getRegionalDemand(crop.areaCode, crop.type));
+    }
+    
+    // Recount a leaf's totals from its in-memory queue (after its overflow file was lost)
+    void rebuildLeafSupply(DecisionNode* leaf) {
+        for (auto it = queuedSupply.begin(); it != queuedSupply.end();) {
+            if (get<2>(it->first) == leaf->nodeId) {
+                it = queuedSupply.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        
+        queue<TransactionNode*> pending = leaf->processingQueue;
+        while (!pending.empty()) {
+            recordQueued(leaf, pending.front()->cropDetails);
+            pending.pop();
+        }
+    }
+    
+    void recordDequeued(DecisionNode* leaf, const Crop& crop) {
+        auto it = queuedSupply.find(make_tuple(crop.areaCode, crop.type, leaf->nodeId));
+        if (it == queuedSupply.end()) return;
+        
+        it->second.remove(crop, getRegionalDemand(crop.areaCode, crop.type));
+        if (it->second.count == 0) {
+            queuedSupply.erase(it);
+        }
+    }
+    
+    // Find another leaf for a crop whose leaf is full: the sibling first, then the emptiest leaf
+    DecisionNode* findLeafWithRoom(DecisionNode* fullLeaf, DecisionNode* parent) {
+        if (parent != nullptr) {
+            DecisionNode* sibling = (parent->leftChild == fullLeaf) ? parent->rightChild : parent->leftChild;
+            if (sibling != nullptr && sibling->leftChild == nullptr && sibling->rightChild == nullptr &&
+                sibling->hasRoom()) {
+                return sibling;
+            }
+        }
+        
+        DecisionNode* best = nullptr;
+        for (const auto& pair : nodeMap) {
+            DecisionNode* node = pair.second;
+            if (node != fullLeaf && node->leftChild == nullptr && node->rightChild == nullptr &&
+                node->hasRoom() && (best == nullptr || node->queueSize() < best->queueSize())) {
+                best = node;
+            }
+        }
+        return best;
+    }
+    
 public:
-    RoutingDecisionTree() {
+    // Status of a crop after routing
+    enum class IngestStatus {
+        Queued,                         // In the leaf's queue
+        Spilled,                        // In the leaf's overflow file
+        Rerouted,                       // Sent to another leaf because its own was full
+        Blocked,                        // Held until the leaf queue drains
+        Rejected                        // Refused because the leaf queue was full
+    };
+    
+    RoutingDecisionTree() : blockedIngestCapacity(1000) {
         // Initialize regional demand data
         setupRegionalDemand();
         
@@ -327,8 +1398,9 @@ public:
     }
     
     // Route the crop through the decision tree
-    DecisionNode* routeCrop(const Crop& crop, TransactionNode* transaction) {
+    DecisionNode* routeCrop(const Crop& crop, TransactionNode* transaction, IngestStatus& status) {
         DecisionNode* current = root;
+        DecisionNode* parent = nullptr;
         string path = "root";
         
         // Calculate demand for this crop in its region
@@ -347,6 +1419,7 @@ public:
                                        " decision: " + (decision ? "left" : "right");
             
             // Move to next node based on decision
+            parent = current;
             if (decision) {
                 path += " -> " + current->leftChild->nodeId;
                 current = current->leftChild;
@@ -358,19 +1431,159 @@ public:
         
         // Now current is a leaf node or null
         if (current != nullptr) {
-            // Add this transaction to the queue of the final node
-            current->enqueue(transaction);
+            // Add routing path to transaction action
+            transaction->actionTaken += " | Final path: " + path;
+            
+            // Apply backpressure when the leaf queue is full
+            status = IngestStatus::Queued;
+            if (!current->hasRoom()) {
+                DecisionNode* alternative = nullptr;
+                if (current->overflowPolicy == OverflowPolicy::Reroute) {
+                    alternative = findLeafWithRoom(current, parent);
+                }
+                
+                if (alternative != nullptr) {
+                    transaction->actionTaken += " | Rerouted from " + current->nodeId + " (queue full)";
+                    current = alternative;
+                    status = IngestStatus::Rerouted;
+                } else if (current->overflowPolicy == OverflowPolicy::Reject ||
+                           (int)blockedIngest.size() >= blockedIngestCapacity) {
+                    // Block falls back to Reject once the holding area is full too
+                    transaction->actionTaken += " | Rejected: " + current->nodeId + " queue full";
+                    status = IngestStatus::Rejected;
+                    return current;
+                } else {
+                    status = IngestStatus::Blocked;
+                }
+            }
             
             // Set next destination in the transaction
             transaction->nextDestination = "Node: " + current->nodeId + " (" + current->description + ")";
             
-            // Add routing path to transaction action
-            transaction->actionTaken += " | Final path: " + path;
+            if (status == IngestStatus::Blocked) {
+                transaction->actionTaken += " | Held: " + current->nodeId + " queue full";
+                blockedIngest.push({current, transaction});
+                return current;
+            }
+            
+            // The transaction may be freed here if it spills to disk
+            recordQueued(current, crop);
+            if (current->enqueue(transaction) == EnqueueResult::Spilled && status == IngestStatus::Queued) {
+                status = IngestStatus::Spilled;
+            }
         }
         
         return current;
     }
     
+    // Move held crops into their leaf queues once there is room; returns how many moved
+    int releaseBlockedIngest() {
+        int released = 0;
+        int pending = blockedIngest.size();
+        
+        for (int i = 0; i < pending; i++) {
+            pair<DecisionNode*, TransactionNode*> held = blockedIngest.front();
+            blockedIngest.pop();
+            
+            if (!held.first->hasRoom()) {
+                blockedIngest.push(held);
+            } else {
+                recordQueued(held.first, held.second->cropDetails);
+                held.first->enqueue(held.second);
+                released++;
+            }
+        }
+        return released;
+    }
+    
+    // Take the next transaction from a leaf queue, keeping supply totals current
+    TransactionNode* dequeueFrom(DecisionNode* leaf) {
+        if (leaf->processingQueue.empty()) {
+            return nullptr;
+        }
+        
+        // Count it out before the leaf refills, which may rebuild the leaf's totals
+        recordDequeued(leaf, leaf->processingQueue.front()->cropDetails);
+        return leaf->dequeue();
+    }
+    
+    // Take up to maxCount transactions from a leaf queue, oldest first
+    vector<TransactionNode*> dequeueBatchFrom(DecisionNode* leaf, int maxCount) {
+        vector<TransactionNode*> batch;
+        while ((int)batch.size() < maxCount && !leaf->processingQueue.empty()) {
+            batch.push_back(dequeueFrom(leaf));
+        }
+        return batch;
+    }
+    
+    // Totals of queued crops; empty arguments match everything
+    SupplySummary querySupply(const string& region = "", const string& cropType = "",
+                              const string& leafId = "") {
+        SupplySummary summary;
+        for (const auto& cell : queuedSupply) {
+            if ((region.empty() || get<0>(cell.first) == region) &&
+                (cropType.empty() || get<1>(cell.first) == cropType) &&
+                (leafId.empty() || get<2>(cell.first) == leafId)) {
+                cell.second.mergeInto(summary);
+            }
+        }
+        return summary;
+    }
+    
+    // Queued totals rolled up over the chosen keys (region, crop type, leaf)
+    vector<pair<string, SupplySummary>> summarizeSupply(bool byRegion, bool byType, bool byLeaf) {
+        map<string, SupplySummary> groups;
+        for (const auto& cell : queuedSupply) {
+            string key;
+            if (byRegion) key += get<0>(cell.first);
+            if (byType) key += (key.empty() ? "" : " / ") + get<1>(cell.first);
+            if (byLeaf) key += (key.empty() ? "" : " / ") + get<2>(cell.first);
+            cell.second.mergeInto(groups[key]);
+        }
+        return vector<pair<string, SupplySummary>>(groups.begin(), groups.end());
+    }
+    
+    // Number of crops held back by full queues
+    int blockedIngestCount() {
+        return blockedIngest.size();
+    }
+    
+    // Set queue limits and backpressure for a leaf; overflow spills to overflow_<nodeId>.dat
+    void configureLeafQueue(const string& nodeId, int capacity, int overflowCapacity, OverflowPolicy policy) {
+        DecisionNode* node = getNode(nodeId);
+        if (node == nullptr || node->leftChild != nullptr || node->rightChild != nullptr) {
+            return;
+        }
+        
+        node->capacity = capacity;
+        node->overflowCapacity = overflowCapacity;
+        node->overflowPolicy = policy;
+        node->overflowFile = "overflow_" + nodeId + ".dat";
+        
+        // Leftovers from an earlier run no longer belong to any queue
+        remove(node->overflowFile.c_str());
+    }
+    
+    // Limit how many crops Block may hold before ingest is rejected
+    void setBlockedIngestCapacity(int capacity) {
+        blockedIngestCapacity = capacity;
+    }
+    
+    // Set the hooks every leaf uses to hand transactions to and from its overflow file
+    void setOverflowHooks(function<void(TransactionNode*, const string&, int64_t)> onSpill,
+                          function<void(TransactionNode*)> onReload,
+                          function<void(const string&)> onOverflowLost) {
+        for (const auto& pair : nodeMap) {
+            DecisionNode* node = pair.second;
+            node->onSpill = onSpill;
+            node->onReload = onReload;
+            node->onOverflowLost = [this, node, onOverflowLost](const string& file) {
+                rebuildLeafSupply(node);
+                if (onOverflowLost) onOverflowLost(file);
+            };
+        }
+    }
+    
     // Get regional demand for a crop
     float getRegionalDemand(const string& region, const string& cropType) {
         // Check if we have demand data for this region and crop
@@ -390,7 +1603,22 @@ public:
             DecisionNode* node = pair.second;
             // Only include leaf nodes (processing nodes)
             if (node->leftChild == nullptr && node->rightChild == nullptr) {
-                result.push_back({pair.first + " (" + node->description + ")", node->queueSize()});
+                string label = pair.first + " (" + node->description + ")";
+                if (node->spilledCount > 0) {
+                    label += " [" + to_string(node->spilledCount) + " in overflow file]";
+                }
+                result.push_back({label, node->queueSize()});
+            }
+        }
+        return result;
+    }
+    
+    // Get IDs of all leaf nodes
+    vector<string> getLeafNodeIds() {
+        vector<string> result;
+        for (const auto& pair : nodeMap) {
+            if (pair.second->leftChild == nullptr && pair.second->rightChild == nullptr) {
+                result.push_back(pair.first);
             }
         }
         return result;
@@ -468,13 +1696,41 @@ private:
     RoutingDecisionTree routingTree;
     vector<string> areaCodes = {"North", "South", "East", "West"};
     
+    // Leaf queue limits
+    const int leafQueueCapacity = 100;          // Transactions kept in memory per leaf
+    const int leafOverflowCapacity = 10000;     // Transactions spilled to disk per leaf
+    const int blockedIngestCapacity = 1000;     // Crops held while their queue is full
+    
     // Generate unique IDs
+    int idCounter;
     string generateUniqueId(string prefix) {
-        static int counter = 1000;
-        return prefix + to_string(++counter);
+        return prefix + to_string(++idCounter);
     }
     
 public:
+    // Constructor
+    AgriculturalSupplyChainApp() {
+        // Continue numbering after IDs archived by earlier runs
+        idCounter = max(1000, traceabilityChain.highestArchivedIdNumber());
+        setupQueueLimits();
+    }
+    
+    // Bound every leaf queue; spilled transactions stay traceable through stubs in the chain
+    void setupQueueLimits() {
+        for (const string& nodeId : routingTree.getLeafNodeIds()) {
+            routingTree.configureLeafQueue(nodeId, leafQueueCapacity, leafOverflowCapacity,
+                                           OverflowPolicy::Block);
+        }
+        
+        routingTree.setBlockedIngestCapacity(blockedIngestCapacity);
+        routingTree.setOverflowHooks(
+            [this](TransactionNode* transaction, const string& file, int64_t offset) {
+                traceabilityChain.spillTransaction(transaction, file, offset);
+            },
+            [this](TransactionNode* transaction) { traceabilityChain.restoreSpilled(transaction); },
+            [this](const string& file) { traceabilityChain.dropSpilled(file); });
+    }
+    
     // Farmer input flow
     void farmerInputCrop() {
         // In a real app, this would be from a form or API
@@ -542,11 +1798,29 @@ public:
         traceabilityChain.addTransaction(farmerNode);
         
         // Route through decision tree and add to the appropriate node's queue
-        DecisionNode* finalNode = routingTree.routeCrop(crop, farmerNode);
+        RoutingDecisionTree::IngestStatus status;
+        DecisionNode* finalNode = routingTree.routeCrop(crop, farmerNode, status);
+        
+        if (status == RoutingDecisionTree::IngestStatus::Rejected) {
+            // A rejected crop never entered the supply chain
+            traceabilityChain.detachTransaction(farmerNode);
+            delete farmerNode;
+            
+            cout << "\nCrop rejected: queue at " << finalNode->nodeId << " is full. Try again later." << endl;
+            return;
+        }
         
         cout << "\nCrop entered successfully!" << endl;
         cout << "Crop ID: " << crop.id << " (save this for tracking)" << endl;
         cout << "Destination node: " << finalNode->nodeId << " - " << finalNode->description << endl;
+        
+        if (status == RoutingDecisionTree::IngestStatus::Rerouted) {
+            cout << "Note: original queue was full, crop was rerouted." << endl;
+        } else if (status == RoutingDecisionTree::IngestStatus::Spilled) {
+            cout << "Note: queue is busy, crop is waiting in the overflow file." << endl;
+        } else if (status == RoutingDecisionTree::IngestStatus::Blocked) {
+            cout << "Note: queue is full, crop is held until traders catch up." << endl;
+        }
     }
     
     // Display all queues and their sizes
@@ -562,6 +1836,10 @@ public:
         for (const auto& pair : queueSizes) {
             cout << "Node: " << pair.first << " - Items in queue: " << pair.second << endl;
         }
+        
+        if (routingTree.blockedIngestCount() > 0) {
+            cout << "Crops held by full queues: " << routingTree.blockedIngestCount() << endl;
+        }
     }
     
     // Display the binary tree structure
@@ -597,8 +1875,23 @@ public:
         
         DecisionNode* selectedNode = availableNodes[nodeIndex-1].second;
         
+        // A trader may move several queued crops together as one lot
+        int lotSize;
+        cout << "Number of crops to process as one lot (1-" << selectedNode->queueSize() << "): ";
+        cin >> lotSize;
+        
+        if (lotSize < 1 || lotSize > selectedNode->queueSize()) {
+            cout << "Invalid lot size." << endl;
+            return;
+        }
+        
+        if (lotSize > 1) {
+            processTraderLot(selectedNode, lotSize);
+            return;
+        }
+        
         // Get next transaction from the selected node's queue
-        TransactionNode* prevTransaction = selectedNode->dequeue();
+        TransactionNode* prevTransaction = routingTree.dequeueFrom(selectedNode);
         
         if (prevTransaction == nullptr) {
             cout << "No crops available in this queue." << endl;
@@ -611,7 +1904,70 @@ public:
         
         // Trader information
         string traderId, location, decision;
+        readTraderDecision(traderId, location, decision);
         
+        // Create new transaction
+        TransactionNode* traderNode = new TransactionNode(
+            generateUniqueId("TRANS"),
+            traderId,
+            "Trader",
+            location,
+            decision,
+            prevTransaction->cropDetails  // Same crop details
+        );
+        
+        // Add to traceability chain, linking with previous transaction
+        traceabilityChain.addTransaction(traderNode, prevTransaction);
+        
+        cout << "\nTrader decision processed successfully!" << endl;
+        cout << "Transaction ID: " << traderNode->transactionId << endl;
+    }
+    
+    // Trader decision applied to a whole lot with a single transaction
+    void processTraderLot(DecisionNode* selectedNode, int lotSize) {
+        vector<TransactionNode*> lot = routingTree.dequeueBatchFrom(selectedNode, lotSize);
+        
+        // Display lot contents
+        cout << "\n===== LOT DETAILS =====" << endl;
+        cout << left << setw(10) << "ID" 
+             << setw(12) << "Type" 
+             << setw(12) << "Quantity" 
+             << setw(10) << "Area" << endl;
+        cout << string(44, '-') << endl;
+        
+        double totalQuantity = 0;
+        for (auto* transaction : lot) {
+            const Crop& crop = transaction->cropDetails;
+            cout << left << setw(10) << crop.id 
+                 << setw(12) << crop.type 
+                 << setw(12) << crop.quantity 
+                 << setw(10) << crop.areaCode << endl;
+            totalQuantity += crop.quantity;
+        }
+        cout << "Total: " << lot.size() << " crops, " << totalQuantity << " kg" << endl;
+        
+        // Trader information
+        string traderId, location, decision;
+        readTraderDecision(traderId, location, decision);
+        
+        // One shared transaction for every crop in the lot
+        TransactionNode* lotNode = new TransactionNode(
+            generateUniqueId("LOT"),
+            traderId,
+            "Trader",
+            location,
+            decision + " (lot of " + to_string(lot.size()) + " crops)",
+            lot
+        );
+        
+        traceabilityChain.addLotTransaction(lotNode);
+        
+        cout << "\nTrader lot decision processed successfully!" << endl;
+        cout << "Transaction ID: " << lotNode->transactionId << endl;
+    }
+    
+    // Read trader details and routing decision
+    void readTraderDecision(string& traderId, string& location, string& decision) {
         cout << "\nEnter trader ID: ";
         cin >> traderId;
         
@@ -634,22 +1990,79 @@ public:
         } else {
             decision = "Route to Export";
         }
+    }
+    
+    // Print one row of a supply table
+    void printSupplyRow(const string& key, int count, double quantity, double meanFreshness,
+                        float freshnessMin, float freshnessMax) {
+        cout << left << setw(30) << key 
+             << setw(8) << count 
+             << setw(12) << quantity 
+             << setw(12) << meanFreshness 
+             << setw(8) << freshnessMin 
+             << setw(8) << freshnessMax;
+    }
+    
+    void printSupplyHeader(const string& keyTitle, bool withDemand) {
+        cout << left << setw(30) << keyTitle 
+             << setw(8) << "Count" 
+             << setw(12) << "Kg" 
+             << setw(12) << "Freshness" 
+             << setw(8) << "Min" 
+             << setw(8) << "Max";
+        if (withDemand) cout << "Demand-weighted kg";
+        cout << endl;
+        cout << string(withDemand ? 96 : 78, '-') << endl;
+    }
+    
+    // Display queued supply totals and an ad-hoc group-by over the chain
+    void displaySupplyAnalytics() {
+        cout << "\n===== QUEUED SUPPLY BY LEAF =====" << endl;
+        printSupplyHeader("Leaf", true);
+        for (const auto& group : routingTree.summarizeSupply(false, false, true)) {
+            const SupplySummary& summary = group.second;
+            printSupplyRow(group.first, summary.count, summary.quantity, summary.meanFreshness(),
+                           summary.freshnessMin, summary.freshnessMax);
+            cout << summary.demandWeightedQuantity << endl;
+        }
         
-        // Create new transaction
-        TransactionNode* traderNode = new TransactionNode(
-            generateUniqueId("TRANS"),
-            traderId,
-            "Trader",
-            location,
-            decision,
-            prevTransaction->cropDetails  // Same crop details
-        );
+        cout << "\n===== QUEUED SUPPLY BY REGION AND TYPE =====" << endl;
+        printSupplyHeader("Region / Type", true);
+        for (const auto& group : routingTree.summarizeSupply(true, true, false)) {
+            const SupplySummary& summary = group.second;
+            printSupplyRow(group.first, summary.count, summary.quantity, summary.meanFreshness(),
+                           summary.freshnessMin, summary.freshnessMax);
+            cout << summary.demandWeightedQuantity << endl;
+        }
         
-        // Add to traceability chain, linking with previous transaction
-        traceabilityChain.addTransaction(traderNode, prevTransaction);
+        SupplySummary total = routingTree.querySupply();
+        cout << "Total queued: " << total.count << " crops, " << total.quantity << " kg, demand-weighted "
+             << total.demandWeightedQuantity << endl;
         
-        cout << "\nTrader decision processed successfully!" << endl;
-        cout << "Transaction ID: " << traderNode->transactionId << endl;
+        // Ad-hoc scan over the in-memory chain, one row per crop at its latest hop
+        cout << "\nGroup crops in the chain by:" << endl;
+        cout << "1. Region" << endl;
+        cout << "2. Crop Type" << endl;
+        cout << "3. Current Handler Type" << endl;
+        cout << "Choice: ";
+        
+        int columnChoice;
+        cin >> columnChoice;
+        
+        SupplyScanEngine::Column column = SupplyScanEngine::Column::Region;
+        if (columnChoice == 2) {
+            column = SupplyScanEngine::Column::CropType;
+        } else if (columnChoice == 3) {
+            column = SupplyScanEngine::Column::HandlerType;
+        }
+        
+        cout << "\n===== CHAIN SCAN =====" << endl;
+        printSupplyHeader("Group", false);
+        for (const auto& group : traceabilityChain.groupBy(column)) {
+            printSupplyRow(group.key, group.count, group.quantity, group.freshnessSum / group.count,
+                           group.freshnessMin, group.freshnessMax);
+            cout << endl;
+        }
     }
     
     // View crop history
@@ -676,6 +2089,13 @@ public:
             cout << "  Handler: " << node->handlerType << " (" << node->handlerId << ")" << endl;
             cout << "  Location: " << node->location << endl;
             cout << "  Action: " << node->actionTaken << endl;
+            if (node->isLot()) {
+                cout << "  Lot: ";
+                for (auto* member : node->lotMembers) {
+                    cout << member->cropDetails.id << " ";
+                }
+                cout << endl;
+            }
             if (!node->nextDestination.empty()) {
                 cout << "  Next Destination: " << node->nextDestination << endl;
             }
@@ -686,6 +2106,15 @@ public:
     // Main menu
     void run() {
         while (true) {
+            // Move old completed chains out of memory
+            traceabilityChain.archiveCompletedChains();
+            
+            // Let held crops into queues that have drained
+            int released = routingTree.releaseBlockedIngest();
+            if (released > 0) {
+                cout << "\n" << released << " held crop(s) moved into processing queues." << endl;
+            }
+            
             cout << "\n===== AGRICULTURAL SUPPLY CHAIN =====" << endl;
             cout << "1. Farmer: Enter New Crop" << endl;
             cout << "2. Trader: Process Crop" << endl;
@@ -693,7 +2122,8 @@ public:
             cout << "4. View Queue Status" << endl;
             cout << "5. View Binary Tree Structure" << endl;
             cout << "6. List All Crops" << endl;
-            cout << "7. Exit" << endl;
+            cout << "7. View Supply Analytics" << endl;
+            cout << "8. Exit" << endl;
             cout << "Choice: ";
             
             int choice;
@@ -719,6 +2149,9 @@ public:
                     traceabilityChain.listAllCrops();
                     break;
                 case 7:
+                    displaySupplyAnalytics();
+                    break;
+                case 8:
                     cout << "Exiting program." << endl;
                     return;
                 default: